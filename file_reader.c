@@ -86,6 +86,12 @@ struct volume_t* fat_open(struct disk_t* pdisk, uint32_t first_sector) {
     volume->root_directory = NULL;
     volume->data_area = NULL;
     volume->fat_data = NULL;
+    volume->extents = NULL;
+    volume->num_of_extents = 0;
+    volume->index_map = NULL;
+    volume->index_size = 0;
+    volume->data_map = NULL;
+    volume->data_map_size = 0;
 
     int err_code = read_super_sector(pdisk, volume);
     if (err_code != SUCCESS) {
@@ -247,16 +253,306 @@ int fat_close (struct volume_t* pvolume) {
         return -1;
     }
 
-    free (pvolume->fat_1);
-    free (pvolume->fat_2);
-    free (pvolume->root_directory);
-    free (pvolume->data_area);
-    free (pvolume->fat_data);
+    if (pvolume->index_map != NULL) {
+        munmap (pvolume->index_map, pvolume->index_size);
+    } else {
+        free (pvolume->fat_1);
+        free (pvolume->fat_2);
+        free (pvolume->root_directory);
+        free (pvolume->fat_data);
+        free (pvolume->extents);
+    }
+    if (pvolume->data_map != NULL) munmap (pvolume->data_map, pvolume->data_map_size);
+    else free (pvolume->data_area);
     free (pvolume);
 
     return 0;
 }
 
+// indeks obok obrazu: zdekodowany FAT, katalog główny i mapa ciągłych fragmentów plików
+struct volume_t* fat_open_indexed (struct disk_t* pdisk, uint32_t first_sector, const char* index_file_name) {
+    if (pdisk == NULL || index_file_name == NULL) {
+        errno = EFAULT;
+        return NULL;
+    }
+
+    struct volume_t *volume = calloc(1, sizeof(struct volume_t));
+    if (volume == NULL) {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    int is_stamp_stale = 0;
+    if (load_index (pdisk, volume, index_file_name, &is_stamp_stale) == SUCCESS) {
+        int err_code = map_data_area (pdisk, volume);
+        if (err_code != SUCCESS) {
+            handle_errno(err_code, volume);
+            return NULL;
+        }
+
+        // metadane się nie zmieniły, tylko rozmiar lub czas modyfikacji - odświeżamy znacznik w indeksie
+        if (is_stamp_stale) {
+            int saved_errno = errno;
+            write_index (pdisk, volume, index_file_name);
+            errno = saved_errno;
+        }
+        return volume;
+    }
+    free (volume);
+
+    volume = fat_open (pdisk, first_sector);
+    if (volume == NULL) return NULL;
+
+    int err_code = build_extent_map (volume);
+    if (err_code != SUCCESS) {
+        handle_errno(err_code, volume);
+        return NULL;
+    }
+
+    // brak możliwości zapisu indeksu nie przeszkadza w otwarciu woluminu
+    int saved_errno = errno;
+    write_index (pdisk, volume, index_file_name);
+    errno = saved_errno;
+
+    return volume;
+}
+
+// obszar danych jest mapowany z obrazu, więc strony są czytane dopiero przy pierwszym dostępie
+int map_data_area (struct disk_t *pdisk, struct volume_t *volume) {
+    size_t offset = (size_t)volume->geometry.cluster2_position * volume->super_sector.bytes_per_sector;
+    size_t dataarea_bytes = (size_t)volume->geometry.user_space * volume->super_sector.bytes_per_sector;
+
+    struct stat image;
+    if (fstat (fileno(pdisk->disk), &image) != 0 || (uint64_t)image.st_size < offset + dataarea_bytes ||
+            dataarea_bytes == 0) {
+        return read_data_area (pdisk, volume);
+    }
+
+    size_t delta = offset % (size_t)sysconf(_SC_PAGESIZE);
+    void *map = mmap (NULL, dataarea_bytes + delta, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+            fileno(pdisk->disk), offset - delta);
+    if (map == MAP_FAILED) return read_data_area (pdisk, volume);
+
+    volume->data_map = map;
+    volume->data_map_size = dataarea_bytes + delta;
+    volume->data_area = (uint8_t *)map + delta;
+    return SUCCESS;
+}
+
+void index_layout (const struct fat_index_header_t *header, size_t offsets[5]) {
+    offsets[0] = (sizeof(struct fat_index_header_t) + 7) & ~(size_t)7;
+    offsets[1] = (offsets[0] + header->fat_bytes + 7) & ~(size_t)7;
+    offsets[2] = (offsets[1] + header->rootdir_bytes + 7) & ~(size_t)7;
+    offsets[3] = (offsets[2] + sizeof(uint16_t) * header->geometry.total_clusters + 7) & ~(size_t)7;
+    offsets[4] = offsets[3] + sizeof(struct fat_extent_t) * header->num_of_extents;
+}
+
+uint32_t index_checksum (const uint8_t *index, size_t size) {
+    struct fat_index_header_t header;
+    memcpy (&header, index, sizeof(struct fat_index_header_t));
+    header.index_crc32c = 0;
+
+    uint32_t crc = crc32c_update (0, &header, sizeof(struct fat_index_header_t));
+    return crc32c_update (crc, index + sizeof(struct fat_index_header_t), size - sizeof(struct fat_index_header_t));
+}
+
+int read_metadata_crc (struct disk_t *pdisk, const struct volume_t *volume, uint32_t *crc) {
+    size_t metadata_bytes = volume->geometry.cluster2_position * volume->super_sector.bytes_per_sector;
+    uint8_t *metadata = malloc (metadata_bytes);
+    if (metadata == NULL) return NOMEM;
+
+    int err_code = disk_read (pdisk, 0, metadata, volume->geometry.cluster2_position);
+    if (err_code == -1) {
+        free (metadata);
+        return DISK_READ_FAULT;
+    }
+
+    *crc = crc32c_update (0, metadata, metadata_bytes);
+    free (metadata);
+    return SUCCESS;
+}
+
+// suma kontrolna metadanych obrazu jest sprawdzana zawsze - obrazy o tym samym rozmiarze i czasie
+// modyfikacji nie muszą być takie same; różny znacznik oznacza tylko, że plik indeksu trzeba odświeżyć
+int load_index (struct disk_t *pdisk, struct volume_t *volume, const char *index_file_name, int *is_stamp_stale) {
+    struct stat image;
+    if (fstat (fileno(pdisk->disk), &image) != 0) return DISK_READ_FAULT;
+
+    int fd = open (index_file_name, O_RDONLY);
+    if (fd == -1) return DISK_READ_FAULT;
+
+    struct stat index;
+    if (fstat (fd, &index) != 0 || (size_t)index.st_size < sizeof(struct fat_index_header_t)) {
+        close (fd);
+        return CORRUPTED;
+    }
+
+    // MAP_PRIVATE - ewentualne zapisy do struktur woluminu nie trafiają do pliku indeksu
+    void *map = mmap (NULL, index.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close (fd);
+    if (map == MAP_FAILED) return DISK_READ_FAULT;
+
+    const struct fat_index_header_t *header = map;
+    size_t offsets[5];
+    index_layout (header, offsets);
+
+    *is_stamp_stale = header->image_size != (uint64_t)image.st_size ||
+            header->image_mtime_sec != (int64_t)image.st_mtim.tv_sec ||
+            header->image_mtime_nsec != (int64_t)image.st_mtim.tv_nsec;
+
+    int valid = header->magic == FAT_INDEX_MAGIC && header->version == FAT_INDEX_VERSION &&
+            offsets[4] == (size_t)index.st_size &&
+            index_checksum (map, index.st_size) == header->index_crc32c &&
+            validate_super_sector (header->super_sector) == SUCCESS;
+
+    // geometria jest liczona od nowa z sektora rozruchowego, a nie brana z pliku
+    if (valid) {
+        volume->super_sector = header->super_sector;
+        calculate_volume_geometry (volume);
+        valid = memcmp (&volume->geometry, &header->geometry, sizeof(struct volume_geometry)) == 0 &&
+                header->fat_bytes == (uint32_t)volume->super_sector.sectors_per_fat * volume->super_sector.bytes_per_sector &&
+                header->rootdir_bytes == volume->geometry.rootdir_size * volume->super_sector.bytes_per_sector;
+    }
+
+    if (valid) {
+        uint32_t crc;
+        valid = read_metadata_crc (pdisk, volume, &crc) == SUCCESS && crc == header->metadata_crc32c;
+    }
+
+    if (!valid) {
+        munmap (map, index.st_size);
+        return CORRUPTED;
+    }
+
+    volume->index_map = map;
+    volume->index_size = index.st_size;
+    volume->fat_1 = (uint8_t *)map + offsets[0];
+    volume->fat_2 = volume->fat_1;
+    volume->root_directory = (struct fat_sfn_t *)((uint8_t *)map + offsets[1]);
+    volume->fat_data = (uint16_t *)((uint8_t *)map + offsets[2]);
+    volume->extents = (struct fat_extent_t *)((uint8_t *)map + offsets[3]);
+    volume->num_of_extents = header->num_of_extents;
+
+    return SUCCESS;
+}
+
+int write_index (struct disk_t *pdisk, struct volume_t *volume, const char *index_file_name) {
+    struct stat image;
+    if (fstat (fileno(pdisk->disk), &image) != 0) return DISK_READ_FAULT;
+
+    struct fat_index_header_t header;
+    memset (&header, 0, sizeof(struct fat_index_header_t));
+    header.magic = FAT_INDEX_MAGIC;
+    header.version = FAT_INDEX_VERSION;
+    header.image_size = image.st_size;
+    header.image_mtime_sec = image.st_mtim.tv_sec;
+    header.image_mtime_nsec = image.st_mtim.tv_nsec;
+    header.fat_bytes = (uint32_t)volume->super_sector.sectors_per_fat * volume->super_sector.bytes_per_sector;
+    header.rootdir_bytes = volume->geometry.rootdir_size * volume->super_sector.bytes_per_sector;
+    header.num_of_extents = volume->num_of_extents;
+    header.super_sector = volume->super_sector;
+    header.geometry = volume->geometry;
+
+    uint32_t crc;
+    int err_code = read_metadata_crc (pdisk, volume, &crc);
+    if (err_code != SUCCESS) return err_code;
+    header.metadata_crc32c = crc;
+
+    size_t offsets[5];
+    index_layout (&header, offsets);
+    uint8_t *buffer = calloc (1, offsets[4]);
+    if (buffer == NULL) return NOMEM;
+
+    memcpy (buffer, &header, sizeof(struct fat_index_header_t));
+    memcpy (buffer + offsets[0], volume->fat_1, header.fat_bytes);
+    memcpy (buffer + offsets[1], volume->root_directory, header.rootdir_bytes);
+    memcpy (buffer + offsets[2], volume->fat_data, sizeof(uint16_t) * volume->geometry.total_clusters);
+    if (volume->num_of_extents > 0) {
+        memcpy (buffer + offsets[3], volume->extents, sizeof(struct fat_extent_t) * volume->num_of_extents);
+    }
+    header.index_crc32c = index_checksum (buffer, offsets[4]);
+    memcpy (buffer, &header, sizeof(struct fat_index_header_t));
+
+    // zapis do unikalnego pliku tymczasowego obok indeksu i rename, żeby równoległe otwarcia
+    // nie pisały do tego samego pliku ani nie zobaczyły połowy indeksu
+    char *tmp_name = malloc (strlen(index_file_name) + 8);
+    if (tmp_name == NULL) {
+        free (buffer);
+        return NOMEM;
+    }
+    sprintf (tmp_name, "%s.XXXXXX", index_file_name);
+
+    int fd = mkstemp (tmp_name);
+    FILE *f = fd == -1 ? NULL : fdopen (fd, "wb");
+    if (fd != -1 && f == NULL) {
+        close (fd);
+        remove (tmp_name);
+    }
+    err_code = f == NULL ? DISK_READ_FAULT : SUCCESS;
+    if (f != NULL) {
+        fchmod (fd, 0644);
+        if (fwrite (buffer, offsets[4], 1, f) != 1) err_code = DISK_READ_FAULT;
+        if (fclose (f) != 0) err_code = DISK_READ_FAULT;
+        if (err_code == SUCCESS && rename (tmp_name, index_file_name) != 0) err_code = DISK_READ_FAULT;
+        if (err_code != SUCCESS) remove (tmp_name);
+    }
+
+    free (tmp_name);
+    free (buffer);
+    return err_code;
+}
+
+int build_extent_map (struct volume_t *volume) {
+    uint32_t capacity = 16;
+    volume->num_of_extents = 0;
+    volume->extents = malloc (sizeof(struct fat_extent_t) * capacity);
+    if (volume->extents == NULL) return NOMEM;
+
+    for (int i = 0; i < volume->super_sector.root_dir_capacity; ++i) {
+        const struct fat_sfn_t *sfn = &volume->root_directory[i];
+        if (sfn->file_name[0] == '\0') break;
+        if (sfn->file_name[0] == 0xe5 || (sfn->file_attribute & FAT_ATTRIB_LABEL) != 0) continue;
+
+        cluster_t cluster = sfn->file_first_low;
+        for (uint32_t steps = 0; is_data_cluster (volume, cluster) && steps < volume->geometry.total_clusters; ++steps) {
+            struct fat_extent_t *last = volume->num_of_extents > 0 ? &volume->extents[volume->num_of_extents - 1] : NULL;
+            if (last != NULL && last->entry == (uint32_t)i && last->first + last->count == cluster) {
+                last->count++;
+            } else {
+                if (volume->num_of_extents == capacity) {
+                    struct fat_extent_t *extents = realloc (volume->extents, sizeof(struct fat_extent_t) * capacity * 2);
+                    if (extents == NULL) return NOMEM;
+                    volume->extents = extents;
+                    capacity *= 2;
+                }
+                volume->extents[volume->num_of_extents].entry = i;
+                volume->extents[volume->num_of_extents].first = cluster;
+                volume->extents[volume->num_of_extents].count = 1;
+                volume->num_of_extents++;
+            }
+            cluster = get_next_cluster (volume, cluster);
+        }
+    }
+
+    return SUCCESS;
+}
+
+// NULL, gdy wolumin nie ma mapy fragmentów; wpis bez klastrów daje *count == 0
+const struct fat_extent_t *find_extents (const struct volume_t *volume, uint32_t entry, uint32_t *count) {
+    *count = 0;
+    if (volume->extents == NULL) return NULL;
+
+    uint32_t low = 0, high = volume->num_of_extents;
+    while (low < high) {
+        uint32_t middle = low + (high - low) / 2;
+        if (volume->extents[middle].entry < entry) low = middle + 1;
+        else high = middle;
+    }
+
+    while (low + *count < volume->num_of_extents && volume->extents[low + *count].entry == entry) (*count)++;
+    return volume->extents + low;
+}
+
 struct file_t* file_open (struct volume_t* pvolume, const char* file_name) {
     if (pvolume == NULL || file_name == NULL) {
         errno = EFAULT;
@@ -548,3 +844,1069 @@ int dir_read (struct dir_t* pdir, struct dir_entry_t* pentry) {
 
     return 0;
 }
+
+uint32_t bytes_per_cluster (const struct volume_t *volume) {
+    return (uint32_t)volume->super_sector.bytes_per_sector * volume->super_sector.sectors_per_cluster;
+}
+
+int is_data_cluster (const struct volume_t *volume, cluster_t cluster) {
+    if (cluster < 2 || cluster >= volume->geometry.total_clusters) return 0;
+    return cluster - 2 < volume->geometry.user_space / volume->super_sector.sectors_per_cluster;
+}
+
+uint8_t *cluster_data (struct volume_t *volume, cluster_t cluster) {
+    return volume->data_area + (size_t)(cluster - 2) * bytes_per_cluster(volume);
+}
+
+int is_regular_file (const struct fat_sfn_t *sfn) {
+    if (sfn->file_name[0] == '\0' || sfn->file_name[0] == 0xe5) return 0;
+    if ((sfn->file_attribute & FAT_ATTRIB_LABEL) != 0) return 0;
+    if ((sfn->file_attribute & FAT_ATTRIB_DIR) != 0) return 0;
+    return 1;
+}
+
+static uint32_t crc32c_table[256];
+static pthread_once_t crc32c_table_once = PTHREAD_ONCE_INIT;
+
+static void crc32c_init_table (void) {
+    for (uint32_t i = 0; i < 256; ++i) {
+        uint32_t crc = i;
+        for (int j = 0; j < 8; ++j) crc = (crc >> 1) ^ (0x82F63B78 & (0 - (crc & 1)));
+        crc32c_table[i] = crc;
+    }
+}
+
+static uint32_t crc32c_sw (uint32_t crc, const uint8_t *buffer, size_t length) {
+    pthread_once(&crc32c_table_once, crc32c_init_table);
+    for (size_t i = 0; i < length; ++i) crc = crc32c_table[(crc ^ buffer[i]) & 0xFF] ^ (crc >> 8);
+    return crc;
+}
+
+#if defined(__x86_64__)
+__attribute__ (( target("sse4.2") ))
+static uint32_t crc32c_hw (uint32_t crc, const uint8_t *buffer, size_t length) {
+    uint64_t crc64 = crc;
+    for (; length >= 8; length -= 8, buffer += 8) {
+        uint64_t word;
+        memcpy(&word, buffer, 8);
+        crc64 = __builtin_ia32_crc32di(crc64, word);
+    }
+    crc = (uint32_t)crc64;
+    for (; length > 0; --length, ++buffer) crc = __builtin_ia32_crc32qi(crc, *buffer);
+    return crc;
+}
+#endif
+
+// crc zaczyna się od 0, wynik można przekazać z powrotem do kolejnego wywołania
+uint32_t crc32c_update (uint32_t crc, const void *buffer, size_t length) {
+    crc = ~crc;
+#if defined(__x86_64__)
+    if (__builtin_cpu_supports("sse4.2")) return ~crc32c_hw(crc, buffer, length);
+#endif
+    return ~crc32c_sw(crc, buffer, length);
+}
+
+static const uint32_t sha256_k[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+#define ROTR32(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+static void sha256_transform (struct sha256_t *ctx, const uint8_t *block) {
+    uint32_t w[64];
+    for (int i = 0; i < 16; ++i) {
+        w[i] = (uint32_t)block[i*4] << 24 | (uint32_t)block[i*4 + 1] << 16 |
+                (uint32_t)block[i*4 + 2] << 8 | (uint32_t)block[i*4 + 3];
+    }
+    for (int i = 16; i < 64; ++i) {
+        uint32_t s0 = ROTR32(w[i - 15], 7) ^ ROTR32(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        uint32_t s1 = ROTR32(w[i - 2], 17) ^ ROTR32(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+
+    uint32_t a = ctx->state[0], b = ctx->state[1], c = ctx->state[2], d = ctx->state[3];
+    uint32_t e = ctx->state[4], f = ctx->state[5], g = ctx->state[6], h = ctx->state[7];
+    for (int i = 0; i < 64; ++i) {
+        uint32_t t1 = h + (ROTR32(e, 6) ^ ROTR32(e, 11) ^ ROTR32(e, 25)) + ((e & f) ^ (~e & g)) + sha256_k[i] + w[i];
+        uint32_t t2 = (ROTR32(a, 2) ^ ROTR32(a, 13) ^ ROTR32(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+        h = g;
+        g = f;
+        f = e;
+        e = d + t1;
+        d = c;
+        c = b;
+        b = a;
+        a = t1 + t2;
+    }
+
+    ctx->state[0] += a;
+    ctx->state[1] += b;
+    ctx->state[2] += c;
+    ctx->state[3] += d;
+    ctx->state[4] += e;
+    ctx->state[5] += f;
+    ctx->state[6] += g;
+    ctx->state[7] += h;
+}
+
+void sha256_init (struct sha256_t *ctx) {
+    static const uint32_t initial[8] = {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+    };
+    memcpy(ctx->state, initial, sizeof(initial));
+    ctx->length = 0;
+    ctx->block_used = 0;
+}
+
+void sha256_update (struct sha256_t *ctx, const void *buffer, size_t length) {
+    const uint8_t *bytes = buffer;
+    ctx->length += length;
+
+    if (ctx->block_used > 0) {
+        size_t fill = 64 - ctx->block_used < length ? 64 - ctx->block_used : length;
+        memcpy(ctx->block + ctx->block_used, bytes, fill);
+        ctx->block_used += fill;
+        bytes += fill;
+        length -= fill;
+        if (ctx->block_used < 64) return;
+        sha256_transform(ctx, ctx->block);
+        ctx->block_used = 0;
+    }
+
+    for (; length >= 64; length -= 64, bytes += 64) sha256_transform(ctx, bytes);
+
+    memcpy(ctx->block, bytes, length);
+    ctx->block_used = length;
+}
+
+void sha256_final (struct sha256_t *ctx, uint8_t digest[32]) {
+    uint64_t bits = ctx->length * 8;
+    uint8_t pad[72] = { 0x80 };
+    size_t pad_len = ctx->block_used < 56 ? 56 - ctx->block_used : 120 - ctx->block_used;
+    for (int i = 0; i < 8; ++i) pad[pad_len + i] = (uint8_t)(bits >> (56 - 8*i));
+    sha256_update(ctx, pad, pad_len + 8);
+
+    for (int i = 0; i < 8; ++i) {
+        digest[i*4] = (uint8_t)(ctx->state[i] >> 24);
+        digest[i*4 + 1] = (uint8_t)(ctx->state[i] >> 16);
+        digest[i*4 + 2] = (uint8_t)(ctx->state[i] >> 8);
+        digest[i*4 + 3] = (uint8_t)ctx->state[i];
+    }
+}
+
+struct hash_job_t {
+    struct volume_t *volume;
+    struct fat_sfn_t **files;
+    struct hash_manifest_t *manifest;
+    int next;
+};
+
+static void *hash_worker (void *arg) {
+    struct hash_job_t *job = arg;
+    for (;;) {
+        int i = __atomic_fetch_add(&job->next, 1, __ATOMIC_RELAXED);
+        if (i >= job->manifest->num_of_entries) break;
+        hash_file_chain(job->volume, job->files[i], &job->manifest->entries[i]);
+    }
+    return NULL;
+}
+
+int get_num_of_threads (int requested, int jobs) {
+    int result = requested;
+    if (result <= 0) result = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (result > jobs) result = jobs;
+    if (result < 1) result = 1;
+    return result;
+}
+
+struct hash_manifest_t* volume_hash_files (struct volume_t* pvolume, int num_threads) {
+    if (pvolume == NULL) {
+        errno = EFAULT;
+        return NULL;
+    }
+
+    struct hash_manifest_t *result = malloc(sizeof(struct hash_manifest_t));
+    struct fat_sfn_t **files = malloc(sizeof(struct fat_sfn_t *) * pvolume->super_sector.root_dir_capacity);
+    if (result == NULL || files == NULL) {
+        errno = ENOMEM;
+        free(result);
+        free(files);
+        return NULL;
+    }
+
+    result->num_of_entries = 0;
+    for (int i = 0; i < pvolume->super_sector.root_dir_capacity; ++i) {
+        if (pvolume->root_directory[i].file_name[0] == '\0') break;
+        if (!is_regular_file(&pvolume->root_directory[i])) continue;
+        files[result->num_of_entries++] = &pvolume->root_directory[i];
+    }
+
+    result->entries = malloc(sizeof(struct file_digest_t) * (result->num_of_entries + 1));
+    if (result->entries == NULL) {
+        errno = ENOMEM;
+        free(result);
+        free(files);
+        return NULL;
+    }
+
+    struct hash_job_t job = { pvolume, files, result, 0 };
+    num_threads = get_num_of_threads(num_threads, result->num_of_entries);
+
+    pthread_t *threads = malloc(sizeof(pthread_t) * num_threads);
+    int started = 0;
+    if (threads != NULL) {
+        for (; started < num_threads - 1; ++started) {
+            if (pthread_create(&threads[started], NULL, hash_worker, &job) != 0) break;
+        }
+    }
+    hash_worker(&job);
+    for (int i = 0; i < started; ++i) pthread_join(threads[i], NULL);
+
+    free(threads);
+    free(files);
+    return result;
+}
+
+// liczy skróty bezpośrednio z obszaru danych, bez kopiowania pliku - z mapą fragmentów
+// cały ciągły przebieg klastrów idzie jednym wywołaniem, bez niej klaster po klastrze
+int hash_file_chain (struct volume_t *pvolume, const struct fat_sfn_t *sfn, struct file_digest_t *digest) {
+    struct dir_entry_t entry;
+    fill_name(&entry, sfn);
+    digest->path[0] = '\\';
+    strcpy(digest->path + 1, entry.name);
+    digest->size = sfn->file_size;
+    digest->clusters = 0;
+    digest->status = SUCCESS;
+
+    struct sha256_t sha;
+    sha256_init(&sha);
+    uint32_t crc = 0;
+
+    uint32_t cluster_bytes = bytes_per_cluster(pvolume);
+    uint32_t bytes_to_read = sfn->file_size;
+    uint32_t num_of_runs;
+    const struct fat_extent_t *runs = find_extents(pvolume, sfn - pvolume->root_directory, &num_of_runs);
+    for (uint32_t i = 0; runs != NULL && i < num_of_runs && bytes_to_read > 0; ++i) {
+        uint64_t run_bytes = (uint64_t)runs[i].count * cluster_bytes;
+        uint32_t chunk = bytes_to_read < run_bytes ? bytes_to_read : (uint32_t)run_bytes;
+        const uint8_t *data = cluster_data(pvolume, runs[i].first);
+        crc = crc32c_update(crc, data, chunk);
+        sha256_update(&sha, data, chunk);
+        bytes_to_read -= chunk;
+        digest->clusters += (chunk + cluster_bytes - 1) / cluster_bytes;
+    }
+    if (runs != NULL && bytes_to_read > 0) digest->status = CORRUPTED;
+
+    cluster_t cluster = sfn->file_first_low;
+    while (runs == NULL && bytes_to_read > 0) {
+        if (!is_data_cluster(pvolume, cluster) || digest->clusters >= pvolume->geometry.total_clusters) {
+            digest->status = CORRUPTED;
+            break;
+        }
+        uint32_t chunk = bytes_to_read < cluster_bytes ? bytes_to_read : cluster_bytes;
+        const uint8_t *data = cluster_data(pvolume, cluster);
+        crc = crc32c_update(crc, data, chunk);
+        sha256_update(&sha, data, chunk);
+        bytes_to_read -= chunk;
+        digest->clusters++;
+        cluster = get_next_cluster(pvolume, cluster);
+    }
+
+    digest->crc32c = crc;
+    sha256_final(&sha, digest->sha256);
+    return digest->status;
+}
+
+void manifest_print (FILE *out, const struct hash_manifest_t *manifest) {
+    if (out == NULL || manifest == NULL) return;
+    fprintf(out, "path\tsize\tclusters\tcrc32c\tsha256\n");
+    for (int i = 0; i < manifest->num_of_entries; ++i) {
+        const struct file_digest_t *entry = &manifest->entries[i];
+        fprintf(out, "%s\t%u\t%u\t%08x\t", entry->path, entry->size, entry->clusters, entry->crc32c);
+        for (int j = 0; j < 32; ++j) fprintf(out, "%02x", entry->sha256[j]);
+        fprintf(out, "%s\n", entry->status == SUCCESS ? "" : "\tCORRUPTED");
+    }
+}
+
+int manifest_close (struct hash_manifest_t *manifest) {
+    if (manifest == NULL) {
+        errno = EFAULT;
+        return -1;
+    }
+
+    free(manifest->entries);
+    free(manifest);
+    return 0;
+}
+
+#define SEARCH_MAX_FIRST_BYTES 4
+#define CLUSTER_BATCH 64
+
+struct matcher_t {
+    const struct search_pattern_t *patterns;
+    int num_of_patterns;
+    int bucket_head[256]; // pierwszy wzorzec zaczynający się danym bajtem
+    int *bucket_next;
+    uint8_t first_bytes[SEARCH_MAX_FIRST_BYTES];
+    int num_of_first_bytes; // 0 - za dużo różnych bajtów, filtr półbajtowy
+    uint8_t nibble_low[16];  // bity kubełków pierwszych bajtów wg młodszego półbajtu
+    uint8_t nibble_high[16]; // i wg starszego; kandydat ma wspólny bit w obu
+    uint32_t max_length;
+};
+
+struct hit_context_t {
+    struct search_result_t *out;
+    const char *path;
+    cluster_t cluster;
+    uint32_t cluster_offset_base;
+    uint32_t file_offset_base;
+    int failed;
+};
+
+// fragment łańcucha pliku - duże pliki są dzielone między wątki po CLUSTER_BATCH klastrów
+struct file_range_t {
+    int file;
+    cluster_t first;
+    uint32_t index; // pozycja pierwszego klastra w łańcuchu
+    uint32_t count;
+};
+
+struct search_job_t {
+    struct volume_t *volume;
+    const struct matcher_t *matcher;
+    enum search_mode_t mode;
+    struct fat_sfn_t **files;
+    char (*paths)[14];
+    int num_of_files;
+    struct file_range_t *ranges;
+    int num_of_ranges;
+    int *owner;
+    uint32_t *chain_index;
+    int next;
+};
+
+static int matcher_init (struct matcher_t *m, const struct search_pattern_t *patterns, int num_of_patterns) {
+    m->patterns = patterns;
+    m->num_of_patterns = num_of_patterns;
+    m->num_of_first_bytes = 0;
+    m->max_length = 0;
+    m->bucket_next = malloc(sizeof(int) * num_of_patterns);
+    if (m->bucket_next == NULL) return NOMEM;
+
+    int distinct = 0;
+    memset(m->nibble_low, 0, sizeof(m->nibble_low));
+    memset(m->nibble_high, 0, sizeof(m->nibble_high));
+    for (int i = 0; i < 256; ++i) m->bucket_head[i] = -1;
+    for (int i = num_of_patterns - 1; i >= 0; --i) {
+        uint8_t first = patterns[i].bytes[0];
+        if (m->bucket_head[first] == -1) {
+            uint8_t bucket = (uint8_t)(1 << (distinct++ % 8));
+            m->nibble_low[first & 0x0F] |= bucket;
+            m->nibble_high[first >> 4] |= bucket;
+            if (m->num_of_first_bytes >= 0 && m->num_of_first_bytes < SEARCH_MAX_FIRST_BYTES) {
+                m->first_bytes[m->num_of_first_bytes++] = first;
+            } else {
+                m->num_of_first_bytes = -1;
+            }
+        }
+        m->bucket_next[i] = m->bucket_head[first];
+        m->bucket_head[first] = i;
+        if (patterns[i].length > m->max_length) m->max_length = patterns[i].length;
+    }
+    if (m->num_of_first_bytes < 0) m->num_of_first_bytes = 0;
+
+    return SUCCESS;
+}
+
+#if defined(__x86_64__)
+// pshufb sprawdza 16 bajtów naraz: bajt jest kandydatem, gdy tablice obu jego półbajtów mają
+// wspólny bit kubełka; fałszywe trafienia odrzuca potem bucket_head
+__attribute__ (( target("ssse3") ))
+static const uint8_t *skip_non_candidates (const struct matcher_t *m, const uint8_t *p, const uint8_t *end) {
+    const __m128i low_table = _mm_loadu_si128((const __m128i *)m->nibble_low);
+    const __m128i high_table = _mm_loadu_si128((const __m128i *)m->nibble_high);
+    const __m128i nibble_mask = _mm_set1_epi8(0x0F);
+
+    for (; end - p >= 16; p += 16) {
+        __m128i block = _mm_loadu_si128((const __m128i *)p);
+        __m128i low = _mm_shuffle_epi8(low_table, _mm_and_si128(block, nibble_mask));
+        __m128i high = _mm_shuffle_epi8(high_table, _mm_and_si128(_mm_srli_epi16(block, 4), nibble_mask));
+        __m128i empty = _mm_cmpeq_epi8(_mm_and_si128(low, high), _mm_setzero_si128());
+        int mask = _mm_movemask_epi8(empty) ^ 0xFFFF;
+        if (mask != 0) return p + __builtin_ctz(mask);
+    }
+    return p;
+}
+#endif
+
+// przy kilku pierwszych bajtach memchr (wektorowy w libc) szuka kandydatów zamiast pętli bajt po bajcie;
+// zapamiętana pozycja każdego bajtu jest szukana ponownie dopiero, gdy skan ją minie.
+// Przy większej liczbie różnych pierwszych bajtów kandydatów wskazuje filtr półbajtowy (SSSE3)
+static const uint8_t *next_candidate (const struct matcher_t *m, ptrdiff_t *cached,
+        const uint8_t *buffer, const uint8_t *p, const uint8_t *end) {
+    if (m->num_of_first_bytes == 0) {
+        for (; p < end; ++p) {
+#if defined(__x86_64__)
+            if (__builtin_cpu_supports("ssse3")) {
+                p = skip_non_candidates(m, p, end);
+                if (p == end) break;
+            }
+#endif
+            if (m->bucket_head[*p] != -1) return p;
+        }
+        return NULL;
+    }
+
+    ptrdiff_t best = end - buffer;
+    for (int i = 0; i < m->num_of_first_bytes; ++i) {
+        if (cached[i] < p - buffer) {
+            const uint8_t *found = memchr(p, m->first_bytes[i], end - p);
+            cached[i] = found != NULL ? found - buffer : end - buffer;
+        }
+        if (cached[i] < best) best = cached[i];
+    }
+    return best == end - buffer ? NULL : buffer + best;
+}
+
+static void push_hit (struct hit_context_t *ctx, int pattern, uint32_t pos) {
+    struct search_result_t *out = ctx->out;
+    if (out->num_of_hits == out->capacity) {
+        int capacity = out->capacity == 0 ? 16 : out->capacity * 2;
+        struct search_hit_t *hits = realloc(out->hits, sizeof(struct search_hit_t) * capacity);
+        if (hits == NULL) {
+            ctx->failed = 1;
+            return;
+        }
+        out->hits = hits;
+        out->capacity = capacity;
+    }
+
+    struct search_hit_t *hit = &out->hits[out->num_of_hits++];
+    strcpy(hit->path, ctx->path);
+    hit->pattern = pattern;
+    hit->cluster = ctx->cluster;
+    hit->cluster_offset = ctx->cluster_offset_base + pos;
+    hit->file_offset = ctx->file_offset_base + pos;
+}
+
+// zgłasza trafienia zaczynające się przed start_limit i kończące się za min_end
+static void matcher_scan (const struct matcher_t *m, const uint8_t *buffer, uint32_t length,
+        uint32_t start_limit, uint32_t min_end, struct hit_context_t *ctx) {
+    const uint8_t *end = buffer + start_limit;
+    ptrdiff_t cached[SEARCH_MAX_FIRST_BYTES];
+    for (int i = 0; i < SEARCH_MAX_FIRST_BYTES; ++i) cached[i] = -1;
+
+    for (const uint8_t *p = buffer; p < end; ++p) {
+        p = next_candidate(m, cached, buffer, p, end);
+        if (p == NULL) return;
+
+        uint32_t pos = p - buffer;
+        for (int i = m->bucket_head[*p]; i != -1; i = m->bucket_next[i]) {
+            uint32_t pattern_length = m->patterns[i].length;
+            if (pos + pattern_length > length || pos + pattern_length <= min_end) continue;
+            if (memcmp(p, m->patterns[i].bytes, pattern_length) == 0) push_hit(ctx, i, pos);
+        }
+    }
+}
+
+// sklejka końca jednego fragmentu z początkiem drugiego - tylko trafienia przechodzące przez granicę
+static void scan_junction (const struct matcher_t *m, const uint8_t *left, uint32_t left_length,
+        const uint8_t *right, uint32_t right_length, struct hit_context_t *ctx) {
+    if (m->max_length < 2) return;
+
+    uint8_t junction[2 * m->max_length];
+    uint32_t tail = left_length < m->max_length - 1 ? left_length : m->max_length - 1;
+    uint32_t head = right_length < m->max_length - 1 ? right_length : m->max_length - 1;
+    memcpy(junction, left + left_length - tail, tail);
+    memcpy(junction + tail, right, head);
+
+    ctx->cluster_offset_base += left_length - tail;
+    ctx->file_offset_base += left_length - tail;
+    matcher_scan(m, junction, tail + head, tail, tail, ctx);
+}
+
+// klaster na końcu zakresu sprawdza też sklejkę z pierwszym klastrem następnego zakresu
+static void search_file_range (struct search_job_t *job, const struct file_range_t *range, struct hit_context_t *ctx) {
+    struct volume_t *volume = job->volume;
+    uint32_t cluster_bytes = bytes_per_cluster(volume);
+    uint32_t bytes_left = job->files[range->file]->file_size - range->index * cluster_bytes;
+    cluster_t cluster = range->first;
+
+    ctx->path = job->paths[range->file];
+    for (uint32_t index = range->index; index < range->index + range->count; ++index) {
+        uint32_t chunk = bytes_left < cluster_bytes ? bytes_left : cluster_bytes;
+        const uint8_t *data = cluster_data(volume, cluster);
+
+        ctx->cluster = cluster;
+        ctx->cluster_offset_base = 0;
+        ctx->file_offset_base = index * cluster_bytes;
+        matcher_scan(job->matcher, data, chunk, chunk, 0, ctx);
+
+        bytes_left -= chunk;
+        cluster_t next = get_next_cluster(volume, cluster);
+        if (bytes_left > 0 && is_data_cluster(volume, next)) {
+            uint32_t next_chunk = bytes_left < cluster_bytes ? bytes_left : cluster_bytes;
+            scan_junction(job->matcher, data, chunk, cluster_data(volume, next), next_chunk, ctx);
+        }
+        cluster = next;
+    }
+}
+
+static int build_file_ranges (struct search_job_t *job) {
+    struct volume_t *volume = job->volume;
+    uint32_t cluster_bytes = bytes_per_cluster(volume);
+    int capacity = 16;
+    job->ranges = malloc(sizeof(struct file_range_t) * capacity);
+    if (job->ranges == NULL) return NOMEM;
+
+    for (int file = 0; file < job->num_of_files; ++file) {
+        uint32_t bytes_left = job->files[file]->file_size;
+        cluster_t cluster = job->files[file]->file_first_low;
+        for (uint32_t index = 0; bytes_left > 0 && is_data_cluster(volume, cluster) &&
+                index < volume->geometry.total_clusters; ++index) {
+            if (index % CLUSTER_BATCH == 0) {
+                if (job->num_of_ranges == capacity) {
+                    struct file_range_t *ranges = realloc(job->ranges, sizeof(struct file_range_t) * capacity * 2);
+                    if (ranges == NULL) return NOMEM;
+                    job->ranges = ranges;
+                    capacity *= 2;
+                }
+                struct file_range_t *range = &job->ranges[job->num_of_ranges++];
+                range->file = file;
+                range->first = cluster;
+                range->index = index;
+                range->count = 0;
+            }
+            job->ranges[job->num_of_ranges - 1].count++;
+            bytes_left -= bytes_left < cluster_bytes ? bytes_left : cluster_bytes;
+            cluster = get_next_cluster(volume, cluster);
+        }
+    }
+
+    return SUCCESS;
+}
+
+static int is_allocated_cluster (const struct volume_t *volume, cluster_t cluster) {
+    if (!is_data_cluster(volume, cluster)) return 0;
+    uint16_t value = volume->fat_data[cluster];
+    return value != 0 && value != 0xFF7;
+}
+
+static void search_allocated_cluster (struct search_job_t *job, cluster_t cluster, struct hit_context_t *ctx) {
+    struct volume_t *volume = job->volume;
+    uint32_t cluster_bytes = bytes_per_cluster(volume);
+    const uint8_t *data = cluster_data(volume, cluster);
+
+    int owner = job->owner[cluster];
+    ctx->path = owner == -1 ? "" : job->paths[owner];
+    ctx->cluster = cluster;
+    ctx->cluster_offset_base = 0;
+    ctx->file_offset_base = owner == -1 ? 0 : job->chain_index[cluster] * cluster_bytes;
+    matcher_scan(job->matcher, data, cluster_bytes, cluster_bytes, 0, ctx);
+
+    if (is_allocated_cluster(volume, cluster + 1)) {
+        scan_junction(job->matcher, data, cluster_bytes, cluster_data(volume, cluster + 1), cluster_bytes, ctx);
+    }
+}
+
+struct search_worker_t {
+    struct search_job_t *job;
+    struct search_result_t out;
+    pthread_t thread;
+    int failed;
+};
+
+static void *search_worker (void *arg) {
+    struct search_worker_t *worker = arg;
+    struct search_job_t *job = worker->job;
+    struct hit_context_t ctx = { &worker->out, "", 0, 0, 0, 0 };
+    int batch = job->mode == SEARCH_FILES ? 1 : CLUSTER_BATCH;
+    int total = job->mode == SEARCH_FILES ? job->num_of_ranges : (int)job->volume->geometry.total_clusters;
+
+    for (;;) {
+        int first = __atomic_fetch_add(&job->next, batch, __ATOMIC_RELAXED);
+        if (first >= total) break;
+        int last = first + batch < total ? first + batch : total;
+        for (int i = first; i < last; ++i) {
+            if (job->mode == SEARCH_FILES) search_file_range(job, &job->ranges[i], &ctx);
+            else if (is_allocated_cluster(job->volume, i)) search_allocated_cluster(job, i, &ctx);
+        }
+    }
+
+    worker->failed = ctx.failed;
+    return NULL;
+}
+
+static int compare_hits (const void *a, const void *b) {
+    const struct search_hit_t *x = a, *y = b;
+    int cmp = strcmp(x->path, y->path);
+    if (cmp != 0) return cmp;
+    if (x->file_offset != y->file_offset) return x->file_offset < y->file_offset ? -1 : 1;
+    if (x->cluster != y->cluster) return x->cluster < y->cluster ? -1 : 1;
+    if (x->cluster_offset != y->cluster_offset) return x->cluster_offset < y->cluster_offset ? -1 : 1;
+    return x->pattern - y->pattern;
+}
+
+static int build_cluster_owners (struct search_job_t *job) {
+    struct volume_t *volume = job->volume;
+    job->owner = malloc(sizeof(int) * volume->geometry.total_clusters);
+    job->chain_index = malloc(sizeof(uint32_t) * volume->geometry.total_clusters);
+    if (job->owner == NULL || job->chain_index == NULL) return NOMEM;
+
+    for (cluster_t i = 0; i < volume->geometry.total_clusters; ++i) job->owner[i] = -1;
+    for (int file = 0; file < job->num_of_files; ++file) {
+        cluster_t cluster = job->files[file]->file_first_low;
+        for (uint32_t index = 0; is_data_cluster(volume, cluster) && job->owner[cluster] == -1; ++index) {
+            job->owner[cluster] = file;
+            job->chain_index[cluster] = index;
+            cluster = get_next_cluster(volume, cluster);
+        }
+    }
+
+    return SUCCESS;
+}
+
+struct search_result_t* volume_search (struct volume_t* pvolume, const struct search_pattern_t *patterns,
+        int num_of_patterns, enum search_mode_t mode, int num_threads) {
+    if (pvolume == NULL || patterns == NULL) {
+        errno = EFAULT;
+        return NULL;
+    }
+
+    if (num_of_patterns <= 0 || (mode != SEARCH_FILES && mode != SEARCH_ALLOCATED)) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    for (int i = 0; i < num_of_patterns; ++i) {
+        if (patterns[i].bytes == NULL) {
+            errno = EFAULT;
+            return NULL;
+        }
+        if (patterns[i].length == 0 || patterns[i].length > bytes_per_cluster(pvolume)) {
+            errno = EINVAL;
+            return NULL;
+        }
+    }
+
+    struct matcher_t matcher;
+    if (matcher_init(&matcher, patterns, num_of_patterns) != SUCCESS) {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    struct search_job_t job = { pvolume, &matcher, mode, NULL, NULL, 0, NULL, 0, NULL, NULL, 0 };
+    struct search_result_t *result = calloc(1, sizeof(struct search_result_t));
+    job.files = malloc(sizeof(struct fat_sfn_t *) * pvolume->super_sector.root_dir_capacity);
+    job.paths = malloc(sizeof(*job.paths) * pvolume->super_sector.root_dir_capacity);
+    int err_code = result == NULL || job.files == NULL || job.paths == NULL ? NOMEM : SUCCESS;
+
+    if (err_code == SUCCESS) {
+        for (int i = 0; i < pvolume->super_sector.root_dir_capacity; ++i) {
+            if (pvolume->root_directory[i].file_name[0] == '\0') break;
+            if (!is_regular_file(&pvolume->root_directory[i])) continue;
+
+            struct dir_entry_t entry;
+            fill_name(&entry, &pvolume->root_directory[i]);
+            job.paths[job.num_of_files][0] = '\\';
+            strcpy(job.paths[job.num_of_files] + 1, entry.name);
+            job.files[job.num_of_files++] = &pvolume->root_directory[i];
+        }
+        if (mode == SEARCH_FILES) err_code = build_file_ranges(&job);
+        else err_code = build_cluster_owners(&job);
+    }
+
+    int jobs = mode == SEARCH_FILES ? job.num_of_ranges : (int)pvolume->geometry.total_clusters / CLUSTER_BATCH + 1;
+    num_threads = get_num_of_threads(num_threads, jobs);
+    struct search_worker_t *workers = calloc(num_threads, sizeof(struct search_worker_t));
+    if (workers == NULL) err_code = NOMEM;
+
+    if (err_code == SUCCESS) {
+        int started = 1;
+        for (int i = 0; i < num_threads; ++i) workers[i].job = &job;
+        for (; started < num_threads; ++started) {
+            if (pthread_create(&workers[started].thread, NULL, search_worker, &workers[started]) != 0) break;
+        }
+        search_worker(&workers[0]);
+        for (int i = 1; i < started; ++i) pthread_join(workers[i].thread, NULL);
+
+        for (int i = 0; i < num_threads; ++i) {
+            if (workers[i].failed) err_code = NOMEM;
+            result->num_of_hits += workers[i].out.num_of_hits;
+        }
+    }
+
+    if (err_code == SUCCESS && result->num_of_hits > 0) {
+        result->hits = malloc(sizeof(struct search_hit_t) * result->num_of_hits);
+        if (result->hits == NULL) err_code = NOMEM;
+    }
+
+    if (err_code == SUCCESS) {
+        result->capacity = result->num_of_hits;
+        int pos = 0;
+        for (int i = 0; i < num_threads; ++i) {
+            if (workers[i].out.num_of_hits == 0) continue;
+            memcpy(result->hits + pos, workers[i].out.hits, sizeof(struct search_hit_t) * workers[i].out.num_of_hits);
+            pos += workers[i].out.num_of_hits;
+        }
+        if (result->num_of_hits > 1) qsort(result->hits, result->num_of_hits, sizeof(struct search_hit_t), compare_hits);
+    }
+
+    if (workers != NULL) {
+        for (int i = 0; i < num_threads; ++i) free(workers[i].out.hits);
+    }
+    free(workers);
+    free(matcher.bucket_next);
+    free(job.files);
+    free(job.paths);
+    free(job.ranges);
+    free(job.owner);
+    free(job.chain_index);
+
+    if (err_code != SUCCESS) {
+        if (result != NULL) free(result->hits);
+        free(result);
+        errno = ENOMEM;
+        return NULL;
+    }
+    return result;
+}
+
+int search_result_close (struct search_result_t *result) {
+    if (result == NULL) {
+        errno = EFAULT;
+        return -1;
+    }
+
+    free(result->hits);
+    free(result);
+    return 0;
+}
+
+static int is_free_cluster (const struct volume_t *volume, cluster_t cluster) {
+    return is_data_cluster(volume, cluster) && volume->fat_data[cluster] == 0;
+}
+
+// liczone w 64 bitach, żeby śmieciowy pierwszy klaster i liczba klastrów nie zawinęły się
+static int is_free_run (const struct volume_t *volume, cluster_t first, uint32_t count) {
+    if (count == 0) return 1;
+    uint64_t last = (uint64_t)first + count - 1;
+    if (last > UINT32_MAX || !is_data_cluster(volume, first) || !is_data_cluster(volume, (cluster_t)last)) return 0;
+
+    for (uint32_t i = 0; i < count; ++i) {
+        if (!is_free_cluster(volume, first + i)) return 0;
+    }
+    return 1;
+}
+
+uint8_t lfn_checksum (const uint8_t *file_name) {
+    uint8_t sum = 0;
+    for (int i = 0; i < 11; ++i) sum = (uint8_t)(((sum & 1) << 7) + (sum >> 1) + file_name[i]);
+    return sum;
+}
+
+// usunięte wpisy LFN leżą tuż przed SFN, od pierwszego fragmentu nazwy w górę katalogu
+int fill_long_name (const struct volume_t *volume, int sfn_index, struct deleted_entry_t *entry) {
+    const struct fat_sfn_t *sfn = &volume->root_directory[sfn_index];
+    int length = 0;
+    int checksum = -1;
+    entry->long_name[0] = '\0';
+
+    for (int i = sfn_index - 1; i >= 0 && length + 13 < (int)sizeof(entry->long_name); --i) {
+        const struct fat_lfn_t *lfn = (const struct fat_lfn_t *)&volume->root_directory[i];
+        if (lfn->order != 0xe5 || lfn->attribute != FAT_ATTRIB_LFN) break;
+        if (checksum != -1 && lfn->checksum != checksum) break;
+        checksum = lfn->checksum;
+
+        uint16_t chars[13];
+        memcpy(chars, lfn->name1, sizeof(lfn->name1));
+        memcpy(chars + 5, lfn->name2, sizeof(lfn->name2));
+        memcpy(chars + 11, lfn->name3, sizeof(lfn->name3));
+        int end = 0;
+        for (int j = 0; j < 13 && !end; ++j) {
+            if (chars[j] == 0x0000 || chars[j] == 0xFFFF) end = 1;
+            else entry->long_name[length++] = chars[j] < 0x80 ? (char)chars[j] : '?';
+        }
+        if (end) break;
+    }
+    entry->long_name[length] = '\0';
+    if (checksum == -1) return 0;
+
+    // suma kontrolna jest bijekcją względem pierwszego bajtu nazwy, więc da się go odzyskać
+    uint8_t name[11];
+    memcpy(name, sfn->file_name, 11);
+    for (int c = 0x21; c < 0x7F; ++c) {
+        name[0] = (uint8_t)c;
+        if (lfn_checksum(name) == checksum) {
+            entry->name[0] = (char)c;
+            return 1;
+        }
+    }
+
+    // żaden pierwszy bajt nie daje tej sumy - wpisy LFN należały do innego pliku
+    entry->long_name[0] = '\0';
+    return 0;
+}
+
+struct undelete_t* volume_scan_deleted (struct volume_t* pvolume) {
+    if (pvolume == NULL) {
+        errno = EFAULT;
+        return NULL;
+    }
+
+    struct undelete_t *result = malloc(sizeof(struct undelete_t));
+    if (result == NULL) {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    result->num_of_entries = 0;
+    result->entries = malloc(sizeof(struct deleted_entry_t) * pvolume->super_sector.root_dir_capacity);
+    if (result->entries == NULL) {
+        errno = ENOMEM;
+        free(result);
+        return NULL;
+    }
+
+    uint32_t cluster_bytes = bytes_per_cluster(pvolume);
+    for (int i = 0; i < pvolume->super_sector.root_dir_capacity; ++i) {
+        const struct fat_sfn_t *sfn = &pvolume->root_directory[i];
+        if (sfn->file_name[0] == '\0') break;
+        if (sfn->file_name[0] != 0xe5 || (sfn->file_attribute & FAT_ATTRIB_LABEL) != 0) continue;
+
+        struct deleted_entry_t *entry = &result->entries[result->num_of_entries++];
+        struct dir_entry_t dir_entry;
+        fill_name(&dir_entry, sfn);
+        strcpy(entry->name, dir_entry.name);
+        entry->name[0] = '_';
+        fill_long_name(pvolume, i, entry);
+
+        entry->entry = i;
+        entry->size = sfn->file_size;
+        entry->first_cluster = sfn->file_first_low;
+        entry->is_directory = (sfn->file_attribute & FAT_ATTRIB_DIR) != 0;
+        entry->cluster_count = entry->is_directory ? 1 :
+                (uint32_t)(((uint64_t)sfn->file_size + cluster_bytes - 1) / cluster_bytes);
+
+        // FAT po usunięciu nie pamięta łańcucha - zakładamy ciągły przebieg od pierwszego klastra
+        entry->is_recoverable = is_free_run(pvolume, entry->first_cluster, entry->cluster_count);
+    }
+
+    return result;
+}
+
+struct file_t* undelete_open (struct volume_t* pvolume, const struct deleted_entry_t *entry) {
+    if (pvolume == NULL || entry == NULL) {
+        errno = EFAULT;
+        return NULL;
+    }
+
+    if (entry->is_directory) {
+        errno = EISDIR;
+        return NULL;
+    }
+
+    // przebieg musi mieścić się w obszarze danych i pokrywać cały rozmiar, więc size jest też
+    // mniejszy od obszaru danych i mieści się w int z file_t
+    uint64_t last = (uint64_t)entry->first_cluster + entry->cluster_count - 1;
+    if ((uint64_t)entry->size > (uint64_t)entry->cluster_count * bytes_per_cluster(pvolume) ||
+            (entry->cluster_count > 0 && (last > UINT32_MAX || !is_data_cluster(pvolume, entry->first_cluster) ||
+            !is_data_cluster(pvolume, (cluster_t)last)))) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    // klastry przejęte przez inne pliki zawierają już ich dane, a nie usuniętego pliku
+    if (!is_free_run(pvolume, entry->first_cluster, entry->cluster_count)) {
+        errno = EBUSY;
+        return NULL;
+    }
+
+    struct file_t *result = malloc (sizeof(struct file_t));
+    if (result == NULL) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    result->size = entry->size;
+    result->curr_position = 0;
+    result->data = malloc(result->size + 1);
+    if (result->data == NULL) {
+        errno = ENOMEM;
+        free(result);
+        return NULL;
+    }
+
+    if (entry->size > 0) memcpy(result->data, cluster_data(pvolume, entry->first_cluster), entry->size);
+    result->data[result->size] = '\0';
+    return result;
+}
+
+int undelete_close (struct undelete_t *undelete) {
+    if (undelete == NULL) {
+        errno = EFAULT;
+        return -1;
+    }
+
+    free(undelete->entries);
+    free(undelete);
+    return 0;
+}
+
+struct carve_signature_t {
+    const char *type;
+    const uint8_t *magic;
+    uint32_t length;
+};
+
+static const struct carve_signature_t carve_signatures[] = {
+    { "jpeg", (const uint8_t *)"\xFF\xD8\xFF", 3 },
+    { "png", (const uint8_t *)"\x89PNG\r\n\x1A\n", 8 },
+    { "gif", (const uint8_t *)"GIF8", 4 },
+    { "pdf", (const uint8_t *)"%PDF-", 5 },
+    { "zip", (const uint8_t *)"PK\x03\x04", 4 },
+    { "riff", (const uint8_t *)"RIFF", 4 },
+    { "elf", (const uint8_t *)"\x7F" "ELF", 4 }
+};
+
+struct carve_worker_t {
+    struct volume_t *volume;
+    int *next;
+    struct carved_t *hits;
+    int num_of_hits;
+    int capacity;
+    int failed;
+    pthread_t thread;
+};
+
+// pliki zaczynają się na granicy klastra, więc wystarczy sprawdzić początek każdego wolnego klastra
+static void *carve_worker (void *arg) {
+    struct carve_worker_t *worker = arg;
+    struct volume_t *volume = worker->volume;
+    int total = (int)volume->geometry.total_clusters;
+    uint32_t cluster_bytes = bytes_per_cluster(volume);
+
+    for (;;) {
+        int first = __atomic_fetch_add(worker->next, CLUSTER_BATCH, __ATOMIC_RELAXED);
+        if (first >= total) break;
+        int last = first + CLUSTER_BATCH < total ? first + CLUSTER_BATCH : total;
+
+        for (int i = first; i < last; ++i) {
+            if (!is_free_cluster(volume, i)) continue;
+            const uint8_t *data = cluster_data(volume, i);
+            for (size_t j = 0; j < sizeof(carve_signatures) / sizeof(carve_signatures[0]); ++j) {
+                const struct carve_signature_t *signature = &carve_signatures[j];
+                if (signature->length > cluster_bytes || data[0] != signature->magic[0]) continue;
+                if (memcmp(data, signature->magic, signature->length) != 0) continue;
+
+                if (worker->num_of_hits == worker->capacity) {
+                    int capacity = worker->capacity == 0 ? 16 : worker->capacity * 2;
+                    struct carved_t *hits = realloc(worker->hits, sizeof(struct carved_t) * capacity);
+                    if (hits == NULL) {
+                        worker->failed = 1;
+                        return NULL;
+                    }
+                    worker->hits = hits;
+                    worker->capacity = capacity;
+                }
+                worker->hits[worker->num_of_hits].cluster = i;
+                worker->hits[worker->num_of_hits].type = signature->type;
+                worker->num_of_hits++;
+                break;
+            }
+        }
+    }
+
+    return NULL;
+}
+
+static int compare_carved (const void *a, const void *b) {
+    const struct carved_t *x = a, *y = b;
+    if (x->cluster == y->cluster) return 0;
+    return x->cluster < y->cluster ? -1 : 1;
+}
+
+struct carve_result_t* volume_carve (struct volume_t* pvolume, int num_threads) {
+    if (pvolume == NULL) {
+        errno = EFAULT;
+        return NULL;
+    }
+
+    struct carve_result_t *result = calloc(1, sizeof(struct carve_result_t));
+    num_threads = get_num_of_threads(num_threads, (int)pvolume->geometry.total_clusters / CLUSTER_BATCH + 1);
+    struct carve_worker_t *workers = calloc(num_threads, sizeof(struct carve_worker_t));
+    if (result == NULL || workers == NULL) {
+        errno = ENOMEM;
+        free(result);
+        free(workers);
+        return NULL;
+    }
+
+    int next = 0;
+    int started = 1;
+    for (int i = 0; i < num_threads; ++i) {
+        workers[i].volume = pvolume;
+        workers[i].next = &next;
+    }
+    for (; started < num_threads; ++started) {
+        if (pthread_create(&workers[started].thread, NULL, carve_worker, &workers[started]) != 0) break;
+    }
+    carve_worker(&workers[0]);
+    for (int i = 1; i < started; ++i) pthread_join(workers[i].thread, NULL);
+
+    int err_code = SUCCESS;
+    for (int i = 0; i < num_threads; ++i) {
+        if (workers[i].failed) err_code = NOMEM;
+        result->num_of_hits += workers[i].num_of_hits;
+    }
+
+    if (err_code == SUCCESS && result->num_of_hits > 0) {
+        result->hits = malloc(sizeof(struct carved_t) * result->num_of_hits);
+        if (result->hits == NULL) err_code = NOMEM;
+    }
+
+    if (err_code == SUCCESS && result->num_of_hits > 0) {
+        int pos = 0;
+        for (int i = 0; i < num_threads; ++i) {
+            if (workers[i].num_of_hits == 0) continue;
+            memcpy(result->hits + pos, workers[i].hits, sizeof(struct carved_t) * workers[i].num_of_hits);
+            pos += workers[i].num_of_hits;
+        }
+        qsort(result->hits, result->num_of_hits, sizeof(struct carved_t), compare_carved);
+
+        for (int i = 0; i < result->num_of_hits; ++i) {
+            cluster_t limit = i + 1 < result->num_of_hits ? result->hits[i + 1].cluster : pvolume->geometry.total_clusters;
+            cluster_t cluster = result->hits[i].cluster;
+            while (cluster < limit && is_free_cluster(pvolume, cluster)) cluster++;
+            result->hits[i].free_run = cluster - result->hits[i].cluster;
+        }
+    }
+
+    for (int i = 0; i < num_threads; ++i) free(workers[i].hits);
+    free(workers);
+
+    if (err_code != SUCCESS) {
+        free(result->hits);
+        free(result);
+        errno = ENOMEM;
+        return NULL;
+    }
+    return result;
+}
+
+int carve_close (struct carve_result_t *result) {
+    if (result == NULL) {
+        errno = EFAULT;
+        return -1;
+    }
+
+    free(result->hits);
+    free(result);
+    return 0;
+}
@@ -7,9 +7,18 @@
 
 #include <stdio.h>
 #include <stdint.h>
+#include <stddef.h>
 #include <errno.h>
 #include <stdlib.h>
 #include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#if defined(__x86_64__)
+#include <tmmintrin.h>
+#endif
 
 #define SUCCESS 0
 #define NOMEM 1
@@ -104,6 +113,12 @@ struct volume_geometry {
     cluster_t total_clusters;
 };
 
+struct fat_extent_t {
+    uint32_t entry; // indeks wpisu w katalogu głównym
+    cluster_t first;
+    uint32_t count;
+};
+
 struct volume_t {
     struct fat_super_t super_sector;
     struct volume_geometry geometry;
@@ -112,6 +127,12 @@ struct volume_t {
     struct fat_sfn_t *root_directory;
     uint8_t *data_area;
     uint16_t *fat_data;
+    struct fat_extent_t *extents; // posortowane po entry; NULL po zwykłym fat_open, fat_open_indexed zawsze je wypełnia
+    uint32_t num_of_extents;
+    void *index_map; // gdy != NULL, fat_1, fat_2, root_directory, fat_data i extents wskazują w mapowanie
+    size_t index_size;
+    void *data_map; // gdy != NULL, data_area wskazuje w mapowanie obrazu
+    size_t data_map_size;
 } __attribute__ (( packed ));
 
 struct volume_t* fat_open (struct disk_t* pdisk, uint32_t first_sector);
@@ -125,6 +146,34 @@ int read_data_area (struct disk_t *pdisk, struct volume_t * volume);
 int read_fat_data (struct volume_t *volume);
 int fat_close (struct volume_t* pvolume);
 
+#define FAT_INDEX_MAGIC 0x58444946
+#define FAT_INDEX_VERSION 2
+
+struct fat_index_header_t {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t image_size;
+    int64_t image_mtime_sec;
+    int64_t image_mtime_nsec;
+    uint32_t metadata_crc32c; // sektory od 0 do początku obszaru danych
+    uint32_t index_crc32c;    // cały plik indeksu, liczony z tym polem równym 0
+    uint32_t fat_bytes;
+    uint32_t rootdir_bytes;
+    uint32_t num_of_extents;
+    struct fat_super_t super_sector;
+    struct volume_geometry geometry;
+} __attribute__ (( packed ));
+
+struct volume_t* fat_open_indexed (struct disk_t* pdisk, uint32_t first_sector, const char* index_file_name);
+int load_index (struct disk_t *pdisk, struct volume_t *volume, const char *index_file_name, int *is_stamp_stale);
+int map_data_area (struct disk_t *pdisk, struct volume_t *volume);
+int write_index (struct disk_t *pdisk, struct volume_t *volume, const char *index_file_name);
+int build_extent_map (struct volume_t *volume);
+const struct fat_extent_t *find_extents (const struct volume_t *volume, uint32_t entry, uint32_t *count);
+int read_metadata_crc (struct disk_t *pdisk, const struct volume_t *volume, uint32_t *crc);
+void index_layout (const struct fat_index_header_t *header, size_t offsets[5]);
+uint32_t index_checksum (const uint8_t *index, size_t size);
+
 struct file_t{
     uint8_t *data;
     int curr_position;
@@ -169,4 +218,117 @@ void fill_name(struct dir_entry_t *entry, const struct fat_sfn_t *sfn);
 int dir_close (struct dir_t* pdir);
 int dir_read (struct dir_t* pdir, struct dir_entry_t* pentry);
 
+uint32_t bytes_per_cluster (const struct volume_t *volume);
+int is_data_cluster (const struct volume_t *volume, cluster_t cluster);
+uint8_t *cluster_data (struct volume_t *volume, cluster_t cluster);
+int is_regular_file (const struct fat_sfn_t *sfn);
+
+uint32_t crc32c_update (uint32_t crc, const void *buffer, size_t length);
+
+struct sha256_t {
+    uint32_t state[8];
+    uint64_t length;
+    uint8_t block[64];
+    uint32_t block_used;
+};
+
+void sha256_init (struct sha256_t *ctx);
+void sha256_update (struct sha256_t *ctx, const void *buffer, size_t length);
+void sha256_final (struct sha256_t *ctx, uint8_t digest[32]);
+
+struct file_digest_t {
+    char path[14];
+    uint32_t size;
+    uint32_t clusters;
+    uint32_t crc32c;
+    uint8_t sha256[32];
+    int status; // SUCCESS albo CORRUPTED gdy łańcuch klastrów jest urwany
+};
+
+struct hash_manifest_t {
+    struct file_digest_t *entries;
+    int num_of_entries;
+};
+
+struct hash_manifest_t* volume_hash_files (struct volume_t* pvolume, int num_threads);
+int hash_file_chain (struct volume_t *pvolume, const struct fat_sfn_t *sfn, struct file_digest_t *digest);
+int get_num_of_threads (int requested, int jobs);
+void manifest_print (FILE *out, const struct hash_manifest_t *manifest);
+int manifest_close (struct hash_manifest_t *manifest);
+
+struct search_pattern_t {
+    const uint8_t *bytes;
+    uint32_t length; // co najwyżej rozmiar klastra
+};
+
+enum search_mode_t {
+    SEARCH_FILES,     // po łańcuchach klastrów plików z katalogu głównego
+    SEARCH_ALLOCATED  // surowo po wszystkich zajętych klastrach
+};
+
+struct search_hit_t {
+    char path[14]; // pusty, gdy klaster nie należy do żadnego pliku
+    int pattern;
+    uint32_t file_offset;
+    cluster_t cluster;
+    uint32_t cluster_offset;
+};
+
+struct search_result_t {
+    struct search_hit_t *hits;
+    int num_of_hits;
+    int capacity;
+};
+
+struct search_result_t* volume_search (struct volume_t* pvolume, const struct search_pattern_t *patterns,
+        int num_of_patterns, enum search_mode_t mode, int num_threads);
+int search_result_close (struct search_result_t *result);
+
+struct fat_lfn_t {
+    uint8_t order;
+    uint16_t name1[5];
+    uint8_t attribute;
+    uint8_t type;
+    uint8_t checksum;
+    uint16_t name2[6];
+    uint16_t first_cluster;
+    uint16_t name3[2];
+} __attribute__ (( packed ));
+
+struct deleted_entry_t {
+    char name[13];       // pierwszy znak odtworzony z sumy kontrolnej LFN, inaczej '_'
+    char long_name[256]; // pusty, gdy przed wpisem nie było usuniętych LFN
+    uint32_t entry;      // indeks w katalogu głównym
+    uint32_t size;
+    cluster_t first_cluster;
+    uint32_t cluster_count;
+    uint8_t is_directory;
+    uint8_t is_recoverable; // cały ciągły przebieg klastrów jest wolny
+};
+
+struct undelete_t {
+    struct deleted_entry_t *entries;
+    int num_of_entries;
+};
+
+struct undelete_t* volume_scan_deleted (struct volume_t* pvolume);
+int fill_long_name (const struct volume_t *volume, int sfn_index, struct deleted_entry_t *entry);
+uint8_t lfn_checksum (const uint8_t *file_name);
+struct file_t* undelete_open (struct volume_t* pvolume, const struct deleted_entry_t *entry);
+int undelete_close (struct undelete_t *undelete);
+
+struct carved_t {
+    cluster_t cluster;
+    uint32_t free_run; // wolne klastry od tego miejsca do zajętego klastra lub kolejnego trafienia
+    const char *type;
+};
+
+struct carve_result_t {
+    struct carved_t *hits;
+    int num_of_hits;
+};
+
+struct carve_result_t* volume_carve (struct volume_t* pvolume, int num_threads);
+int carve_close (struct carve_result_t *result);
+
 #endif //PROJECT1_FILE_READER_H
@@ -1,6 +1,139 @@
 #include "file_reader.h"
 
-int main() {
+int run_search(struct volume_t *volume, int num_of_patterns, char **strings, enum search_mode_t mode) {
+    struct search_pattern_t patterns[num_of_patterns > 0 ? num_of_patterns : 1];
+    for (int i = 0; i < num_of_patterns; ++i) {
+        patterns[i].bytes = (const uint8_t *)strings[i];
+        patterns[i].length = strlen(strings[i]);
+    }
 
+    struct search_result_t *found = volume_search(volume, patterns, num_of_patterns, mode, 0);
+    if (found == NULL) {
+        perror("search");
+        return 1;
+    }
+
+    printf("path\tfile_offset\tcluster\tcluster_offset\tpattern\n");
+    for (int i = 0; i < found->num_of_hits; ++i) {
+        struct search_hit_t *hit = &found->hits[i];
+        printf("%s\t%u\t%u\t%u\t%s\n", hit->path[0] != '\0' ? hit->path : "-", hit->file_offset,
+                hit->cluster, hit->cluster_offset, strings[hit->pattern]);
+    }
+    search_result_close(found);
     return 0;
 }
+
+int run_undelete(struct volume_t *volume, const char *entry_index, const char *output) {
+    struct undelete_t *deleted = volume_scan_deleted(volume);
+    if (deleted == NULL) {
+        perror("deleted");
+        return 1;
+    }
+
+    int result = 0;
+    if (entry_index == NULL) {
+        printf("entry\tname\tlong_name\tsize\tfirst_cluster\tclusters\trecoverable\n");
+        for (int i = 0; i < deleted->num_of_entries; ++i) {
+            struct deleted_entry_t *entry = &deleted->entries[i];
+            printf("%u\t%s%s\t%s\t%u\t%u\t%u\t%s\n", entry->entry, entry->name, entry->is_directory ? "\\" : "",
+                    entry->long_name[0] != '\0' ? entry->long_name : "-", entry->size, entry->first_cluster,
+                    entry->cluster_count, entry->is_recoverable ? "yes" : "no");
+        }
+    } else {
+        struct deleted_entry_t *entry = NULL;
+        for (int i = 0; i < deleted->num_of_entries; ++i) {
+            if (deleted->entries[i].entry == (uint32_t)atoi(entry_index)) entry = &deleted->entries[i];
+        }
+
+        struct file_t *file = entry != NULL ? undelete_open(volume, entry) : NULL;
+        FILE *out = file != NULL && output != NULL ? fopen(output, "wb") : NULL;
+        if (entry == NULL || output == NULL) {
+            fprintf(stderr, "usage: recover <entry> <output> (entry from 'deleted')\n");
+            result = 1;
+        } else if (file == NULL && errno == EBUSY) {
+            fprintf(stderr, "recover: clusters of entry %u are now used by other files, not recoverable\n", entry->entry);
+            result = 1;
+        } else if (file == NULL || out == NULL) {
+            perror("recover");
+            result = 1;
+        } else if (file->size > 0 && fwrite(file->data, file->size, 1, out) != 1) {
+            perror(output);
+            result = 1;
+        }
+
+        if (out != NULL) fclose(out);
+        if (file != NULL) file_close(file);
+    }
+
+    undelete_close(deleted);
+    return result;
+}
+
+int main(int argc, char **argv) {
+    const char *index_file_name = NULL;
+    int command = 2;
+    if (argc > 3 && strcmp(argv[2], "-i") == 0) {
+        index_file_name = argv[3];
+        command = 4;
+    }
+
+    if (argc <= command) {
+        fprintf(stderr, "usage: %s <image> [-i <index>] hash [threads]\n", argv[0]);
+        fprintf(stderr, "       %s <image> [-i <index>] search|search-raw <string>...\n", argv[0]);
+        fprintf(stderr, "       %s <image> [-i <index>] deleted|carve\n", argv[0]);
+        fprintf(stderr, "       %s <image> [-i <index>] recover <entry> <output>\n", argv[0]);
+        return 1;
+    }
+
+    const char *name = argv[command];
+    char **args = argv + command + 1;
+    int num_of_args = argc - command - 1;
+
+    struct disk_t *disk = disk_open_from_file(argv[1]);
+    if (disk == NULL) {
+        perror(argv[1]);
+        return 1;
+    }
+
+    struct volume_t *volume = index_file_name != NULL ? fat_open_indexed(disk, 0, index_file_name) : fat_open(disk, 0);
+    if (volume == NULL) {
+        perror("fat_open");
+        disk_close(disk);
+        return 1;
+    }
+
+    int result = 0;
+    if (strcmp(name, "hash") == 0) {
+        struct hash_manifest_t *manifest = volume_hash_files(volume, num_of_args > 0 ? atoi(args[0]) : 0);
+        if (manifest == NULL) {
+            perror("hash");
+            result = 1;
+        } else {
+            manifest_print(stdout, manifest);
+            manifest_close(manifest);
+        }
+    } else if (strcmp(name, "search") == 0 || strcmp(name, "search-raw") == 0) {
+        result = run_search(volume, num_of_args, args, strcmp(name, "search") == 0 ? SEARCH_FILES : SEARCH_ALLOCATED);
+    } else if (strcmp(name, "deleted") == 0 || strcmp(name, "recover") == 0) {
+        result = run_undelete(volume, num_of_args > 0 ? args[0] : NULL, num_of_args > 1 ? args[1] : NULL);
+    } else if (strcmp(name, "carve") == 0) {
+        struct carve_result_t *carved = volume_carve(volume, 0);
+        if (carved == NULL) {
+            perror("carve");
+            result = 1;
+        } else {
+            printf("cluster\tfree_run\ttype\n");
+            for (int i = 0; i < carved->num_of_hits; ++i) {
+                printf("%u\t%u\t%s\n", carved->hits[i].cluster, carved->hits[i].free_run, carved->hits[i].type);
+            }
+            carve_close(carved);
+        }
+    } else {
+        fprintf(stderr, "unknown command: %s\n", name);
+        result = 1;
+    }
+
+    fat_close(volume);
+    disk_close(disk);
+    return result;
+}